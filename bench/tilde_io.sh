@@ -0,0 +1,47 @@
+#!/bin/sh
+# Times the '~' command on 4 small files with a cold page cache, comparing the
+# io_uring path with the MICROSHELL_NO_IO_URING=1 fallback.
+# Usage: bench/tilde_io.sh [directory on the storage to test] [runs]
+set -e
+
+SRC=$(cd "$(dirname "$0")/.." && pwd)
+DIR=${1:-/tmp/microshell_bench}
+RUNS=${2:-50}
+
+mkdir -p "$DIR"
+cd "$DIR"
+gcc -O2 -o microshell "$SRC/microshell.c"
+for f in f1 f2 f3 f4; do
+    head -c 3072 /dev/urandom | base64 > $f
+done
+sync
+
+# Drop only the data files from the page cache, so shell startup stays warm
+evict() {
+    for f in f1 f2 f3 f4; do
+        dd if=$f iflag=nocache count=0 status=none
+    done
+}
+
+# Prints the wall time of one cold '~' command in microseconds
+run() {
+    evict
+    start=$(date +%s%N)
+    printf 'f1 ~ f2 ~ f3 ~ f4\ndter\n' | env "$@" ./microshell > /dev/null
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000 ))
+}
+
+uring=0
+sync_io=0
+i=0
+while [ $i -lt $RUNS ]; do
+    # Alternate the two modes so drift affects both equally
+    uring=$(( uring + $(run) ))
+    sync_io=$(( sync_io + $(run MICROSHELL_NO_IO_URING=1) ))
+    i=$(( i + 1 ))
+done
+
+echo "runs: $RUNS, files: 4 x 4 KiB in $DIR"
+echo "io_uring: $(( uring / RUNS )) us per command"
+echo "syscalls: $(( sync_io / RUNS )) us per command"
@@ -5,15 +5,75 @@
 #include <sys/wait.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <ctype.h>
+
+// io_uring is used for batched file I/O when the kernel headers provide it
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#undef MAX_INPUT  // Pulled in from linux/limits.h; the shell's own limit is below
+#endif
+#endif
 
 #define MAX_INPUT 1024
 #define MAX_ARGS 4
 #define MAX_COMMANDS 4
 #define DELIMITERS " \t\n"
+#define PMAP_MAX_ARGS 64   // Maximum words in a pmap command after batching
+#define PMAP_MAX_JOBS 64   // Maximum concurrent pmap children
+#define PMAP_PENDING_FACTOR 4  // Unprinted batches allowed per job slot in -k mode
+#define VAR_BUCKETS 256    // Buckets in the shell variable table
+#define URING_ENTRIES (2 * MAX_COMMANDS)  // An open and a stat per file
+#define URING_READ_SIZE 65536  // Bytes of each file read through io_uring
 
 // Global variable to store the last background process PID
 pid_t bg_pid = -1;
 
+// Structure for one shell variable, interned by name in var_table
+struct shell_var {
+    char *name;
+    char *value;             // NULL for a name exported before it was set
+    char *env_entry;         // "NAME=VALUE" string handed to exec, built on demand
+    int exported;            // Whether the variable is passed to children
+    struct shell_var *next;  // Next variable in the same bucket
+};
+
+extern char **environ;
+
+struct shell_var *var_table[VAR_BUCKETS];  // Shell and exported variables
+char **env_cache = NULL;   // envp array built from the exported variables
+int env_cache_cap = 0;     // Allocated slots in env_cache
+int env_dirty = 1;         // Set when the exported set changes
+char **env_stale = NULL;   // Replaced "NAME=VALUE" strings still in env_cache
+int env_stale_count = 0;
+int env_stale_cap = 0;
+char **expanded_words = NULL;  // Words allocated by expand_word for this command
+int expanded_count = 0;
+int expanded_cap = 0;
+int last_status = 0;       // Exit status of the last command, for $?
+pid_t last_bg_pid = -1;    // PID of the last background command, for $!
+
+#ifdef USE_IO_URING
+// Structure for the mapped submission and completion rings
+struct uring {
+    int fd;
+    char *rings;           // Mapping shared by the submission and completion rings
+    size_t rings_size;
+    size_t sqes_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+};
+
+struct uring ring;     // Shared by every command, set up on first use
+int uring_state = 0;   // 0 untried, 1 ready, -1 unavailable
+#endif
+
 //function declarations
 int split_input_string(char *input, char *args[], int *argc);
 void execute_cmd(char *args[]);
@@ -25,20 +85,50 @@ void handle_pipe(char *input);
 void handle_redirection(char *input);
 void handle_semicolon(char *input);
 int handle_conditional_execution(char *input);
+int handle_pmap(char *input);
 
 void execute_in_background(char *args[]);
 void handle_special_chars(char *input);
 void fork_and_execute_wc(const char *file_name);
-void fork_and_execute_cmds(char *cmds[], int num_cmds, int pipe_fds[][2]);
+pid_t fork_and_execute_cmds(char *cmds[], int num_cmds, int pipe_fds[][2]);
 void check_process_status(pid_t pid, int status);
 int execute_single_command(char *cmd[]);
 void print_error(const char *message);
+pid_t pmap_spawn(char *cmd[], int cmd_argc, char *items[], int item_count, FILE *out, int null_stdin);
+int exit_code(int status);
+
+void init_variables();
+struct shell_var *var_lookup(const char *name, size_t len, int create);
+void var_set(const char *name, const char *value);
+void var_unset(const char *name);
+void update_environ();
+int is_valid_name(const char *name, size_t len);
+int is_assignment(const char *input);
+size_t expand_variables(const char *input, char *output);
+char *expand_word(char *word);
+void free_expanded_words();
+void env_retire(char *entry);
+void handle_assignment(char *input);
+void handle_export(char *input);
+void handle_unset(char *input);
+
+int cat_files_sync(char *files[], int file_count);
+#ifdef USE_IO_URING
+int uring_init();
+void uring_shutdown();
+struct io_uring_sqe *uring_get_sqe(unsigned index);
+int uring_submit_and_wait(unsigned count, int results[]);
+int cat_files_uring(char *files[], int file_count);
+#endif
 
 
 int main() {
     char input[MAX_INPUT];  // Buffer to hold the user input
     int is_run = 1;        // Flag to control the loop
 
+    // Import the inherited environment as exported variables
+    init_variables();
+
     // Start the command loop
     while (is_run) {
         printf("microshell$ ");  
@@ -52,6 +142,12 @@ int main() {
        
         input[strcspn(input, "\n")] = 0;  // Remove newline character from the input
 
+        // Release the words expanded for the previous command
+        free_expanded_words();
+
+        // Rebuild the environment for exec only if the exported set changed
+        update_environ();
+
         // Command handling
         if (strcmp(input, "dter") == 0) {
             printf("Killed\n"); // If the input command is "dter", print "Killed" and stop the loop
@@ -59,6 +155,18 @@ int main() {
         } else if (strcmp(input, "fore") == 0) {
             // If the input command is "fore", handle foreground process
             handle_foreground();
+        } else if (strncmp(input, "export", 6) == 0 && (input[6] == ' ' || input[6] == '\t' || input[6] == '\0')) {
+            // If the input command is "export", mark variables as exported
+            handle_export(input);
+        } else if (strncmp(input, "unset", 5) == 0 && (input[5] == ' ' || input[5] == '\t' || input[5] == '\0')) {
+            // If the input command is "unset", remove variables
+            handle_unset(input);
+        } else if (is_assignment(input)) {
+            // If the input is NAME=VALUE, set a shell variable
+            handle_assignment(input);
+        } else if (strncmp(input, "pmap", 4) == 0 && (input[4] == ' ' || input[4] == '\t' || input[4] == '\0')) {
+            // If the input command is "pmap", fan the command out over input lines
+            last_status = handle_pmap(input);
         } else {
             // For other commands, handle special characters in the input
             handle_special_chars(input);
@@ -79,6 +187,7 @@ void execute_cmd(char *args[]) {
     // Check if the number of arguments is within the valid range
     if (argc < 1 || argc > MAX_ARGS) {
         print_error("Error: Number of arguments must be between 1 and 4.");
+        last_status = 1;
         return;
     }
 
@@ -86,6 +195,7 @@ void execute_cmd(char *args[]) {
     if (strcmp(args[0], "grep") == 0) {
         if (argc > 3) {
             print_error("grep: wrong syntax");
+            last_status = 1;
             return;
         }
     }
@@ -94,6 +204,7 @@ void execute_cmd(char *args[]) {
     int pipefd[2];
     if (pipe(pipefd) == -1) {
         perror("pipe");
+        last_status = 1;
         return;
     }
 
@@ -134,6 +245,7 @@ void execute_cmd(char *args[]) {
 
         // Wait for the child process to complete
         waitpid(pid, &status, 0);
+        last_status = exit_code(status);
 
         // Check if no output was received and the command was 'grep'
         if (!get_op && strcmp(args[0], "grep") == 0) {
@@ -142,6 +254,7 @@ void execute_cmd(char *args[]) {
     } else {
         // If fork fails
         perror("fork");
+        last_status = 1;
     }
 }
 
@@ -154,17 +267,19 @@ char *file_name;
     // Ensure a filename was provided
     if (!file_name) {
         print_error("No filename provided after '#'.");
+        last_status = 1;
         return;
     }
 
     // Check for additional arguments (syntax error)
     if (strtok(NULL, DELIMITERS)) {
         print_error("Syntax error: Extra arguments found.");
+        last_status = 1;
         return;
     }
 
     // Fork and execute the command
-    fork_and_execute_wc(file_name);
+    fork_and_execute_wc(expand_word(file_name));
 }
 void fork_and_execute_wc(const char *file_name) {
     // Fork a new process
@@ -173,6 +288,7 @@ void fork_and_execute_wc(const char *file_name) {
     if (child_pid == -1) {
         // Fork failed
         print_error("Failed to create child process.");
+        last_status = 1;
         return;
     } else if (child_pid == 0) {
         // In child process
@@ -185,6 +301,7 @@ void fork_and_execute_wc(const char *file_name) {
         // In parent process
         int status;
         waitpid(child_pid, &status, 0);
+        last_status = exit_code(status);
 
         // Check if child exited normally and with success
         if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
@@ -203,6 +320,7 @@ void handle_tilde(char *input) {
     // Check if input starts with '~'
     if (input[0] == '~') {
         print_error("Syntax error: Input must not start with '~'");
+        last_status = 1;
         return;
     }
 
@@ -218,9 +336,13 @@ void handle_tilde(char *input) {
         // Check for empty segments and ensure file count limit
         if (strlen(token) > 0) {
             if (file_count < MAX_COMMANDS) {
-                files[file_count++] = strdup(token); // Store a copy of the trimmed token
+                files[file_count++] = strdup(expand_word(token)); // Store a copy of the trimmed, expanded token
             } else {
                 print_error("Too many files specified. Maximum allowed is 4");
+                for (int i = 0; i < file_count; i++) {
+                    free(files[i]);
+                }
+                last_status = 1;
                 return;
             }
         }
@@ -230,29 +352,340 @@ void handle_tilde(char *input) {
     // Validate file count
     if (file_count == 0) {
         print_error("No files specified");
+        last_status = 1;
         return;
     }
 
-    // Process each file
+    // Process the files, batching their I/O through io_uring when the kernel allows it
+    int failures = -1;
+#ifdef USE_IO_URING
+    if (getenv("MICROSHELL_NO_IO_URING") == NULL && uring_init()) {
+        failures = cat_files_uring(files, file_count);
+    }
+#endif
+    if (failures < 0) {
+        failures = cat_files_sync(files, file_count);
+    }
+    last_status = failures > 0;  // Any file that could not be printed fails the command
+
+    for (int i = 0; i < file_count; i++) {
+        free(files[i]); // Free allocated memory for the file names
+    }
+}
+
+// Function to print files in order with blocking stdio, one file at a time
+// Returns the number of files that could not be printed
+int cat_files_sync(char *files[], int file_count) {
+    int failures = 0;
     for (int i = 0; i < file_count; i++) {
         FILE *file = fopen(files[i], "r"); // Open file for reading
         if (file == NULL) {
             fprintf(stderr, "Error opening file '%s': %s\n", files[i], strerror(errno));
+            failures++;
             continue; // Continue with the next file
         }
 
-        char buffer[1024];
-        // Read and print file contents
-        while (fgets(buffer, sizeof(buffer), file) != NULL) {
-            printf("%s", buffer);
+        char buffer[4096];
+        size_t bytes;
+        // Read and print file contents as raw bytes, so NUL bytes are kept
+        while ((bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            fwrite(buffer, 1, bytes, stdout);
+        }
+        if (ferror(file)) {
+            // e.g. a directory, which opens fine but cannot be read
+            fprintf(stderr, "Error reading file '%s': %s\n", files[i], strerror(errno));
+            failures++;
         }
         printf("\n"); 
 
         fclose(file); 
-        free(files[i]); // Free allocated memory for the file name
     }
+    return failures;
+}
+
+#ifdef USE_IO_URING
+// Function to map the rings and check the kernel supports the opcodes we use
+int uring_init() {
+    if (uring_state != 0) {
+        return uring_state == 1;
+    }
+    uring_state = -1;  // Assume unavailable until every step succeeds
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (fd < 0) {
+        return 0;  // Old kernel, seccomp or io_uring disabled: use the syscalls
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);  // Children must not inherit the ring
+
+    // Single mmap of both rings is available since 5.4; require it to keep this small
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t ring_size = sq_size > cq_size ? sq_size : cq_size;
+    char *rings = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    struct io_uring_sqe *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        munmap(rings, ring_size);
+        close(fd);
+        return 0;
+    }
+
+    // OPENAT, STATX and READ arrived in 5.6; probe instead of guessing from the version
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    int supported = probe != NULL && syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    int ops[] = {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ};
+    for (int i = 0; supported && i < 3; i++) {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!supported) {
+        munmap(sqes, params.sq_entries * sizeof(struct io_uring_sqe));
+        munmap(rings, ring_size);
+        close(fd);
+        return 0;
+    }
+
+    ring.fd = fd;
+    ring.rings = rings;
+    ring.rings_size = ring_size;
+    ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sq_tail = (unsigned *)(rings + params.sq_off.tail);
+    ring.sq_mask = (unsigned *)(rings + params.sq_off.ring_mask);
+    ring.sq_array = (unsigned *)(rings + params.sq_off.array);
+    ring.cq_head = (unsigned *)(rings + params.cq_off.head);
+    ring.cq_tail = (unsigned *)(rings + params.cq_off.tail);
+    ring.cq_mask = (unsigned *)(rings + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+    ring.sqes = sqes;
+    uring_state = 1;
+    return 1;
+}
+
+// Function to tear the ring down after a failure; later commands use the syscalls
+void uring_shutdown() {
+    // Closing the ring cancels or completes whatever the kernel still holds
+    munmap(ring.sqes, ring.sqes_size);
+    munmap(ring.rings, ring.rings_size);
+    close(ring.fd);
+    uring_state = -1;
+}
+
+// Function to claim the next submission entry; the caller fills it in
+struct io_uring_sqe *uring_get_sqe(unsigned index) {
+    unsigned tail = *ring.sq_tail + index;
+    unsigned slot = tail & *ring.sq_mask;
+    struct io_uring_sqe *sqe = &ring.sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sq_array[slot] = slot;
+    return sqe;
 }
 
+// Function to submit count queued entries and store each result by user_data
+// Returns 0 on success, -1 if submission failed but every submitted entry was
+// reaped, and -2 if entries may still be in flight in the kernel
+int uring_submit_and_wait(unsigned count, int results[]) {
+    // Publish all entries with one tail update so the kernel sees the whole batch
+    __atomic_store_n(ring.sq_tail, *ring.sq_tail + count, __ATOMIC_RELEASE);
+
+    unsigned to_submit = count;
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    int failed = 0;
+    while (completed < (failed ? submitted : count)) {
+        int ret = (int)syscall(__NR_io_uring_enter, ring.fd, failed ? 0 : to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (failed) {
+                return -2;  // Cannot even wait for what was submitted
+            }
+            // Stop submitting, but drain what the kernel already accepted
+            failed = 1;
+            continue;
+        }
+        if (!failed) {
+            to_submit -= (unsigned)ret;
+            submitted += (unsigned)ret;
+        }
+
+        // Reap everything that has completed so far
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            results[cqe->user_data] = cqe->res;
+            head++;
+            completed++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+    return failed ? -1 : 0;
+}
+
+// Function to print files in order, overlapping their opens, stats and first reads
+// Returns the number of files that could not be printed, or -1 to use the syscalls
+int cat_files_uring(char *files[], int file_count) {
+    int fds[MAX_COMMANDS];
+    char *buffers[MAX_COMMANDS] = {0};
+    int results[URING_ENTRIES];
+
+    // The kernel writes stats and reads paths asynchronously, so neither may live
+    // in this frame or in the caller's files[]; both are leaked if the ring is abandoned
+    struct statx *stats = calloc(file_count, sizeof(struct statx));
+    char *paths[MAX_COMMANDS] = {0};
+    int copied = stats != NULL;
+    for (int i = 0; copied && i < file_count; i++) {
+        copied = (paths[i] = strdup(files[i])) != NULL;
+    }
+    if (!copied) {
+        free(stats);
+        for (int i = 0; i < file_count; i++) {
+            free(paths[i]);
+        }
+        return -1;
+    }
+
+    // Entries that never complete keep this result
+    for (int i = 0; i < URING_ENTRIES; i++) {
+        results[i] = -ECANCELED;
+    }
+
+    // Phase 1: open and stat every file at once
+    for (int i = 0; i < file_count; i++) {
+        struct io_uring_sqe *sqe = uring_get_sqe(2 * i);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)paths[i];
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        sqe->user_data = 2 * i;
+
+        sqe = uring_get_sqe(2 * i + 1);
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (unsigned long)paths[i];
+        sqe->len = STATX_TYPE | STATX_SIZE;
+        sqe->off = (unsigned long)&stats[i];
+        sqe->user_data = 2 * i + 1;
+    }
+    int ret = uring_submit_and_wait(2 * file_count, results);
+    if (ret != 0) {
+        // Close what did open; an open still in flight after -2 cannot be recovered
+        for (int i = 0; i < file_count; i++) {
+            if (results[2 * i] >= 0) close(results[2 * i]);
+        }
+        uring_shutdown();
+        if (ret == -1) {
+            free(stats);
+            for (int i = 0; i < file_count; i++) {
+                free(paths[i]);
+            }
+        }
+        return -1;
+    }
+
+    // Phase 2: read the first chunk of every opened file at once
+    size_t lens[MAX_COMMANDS];
+    size_t sizes[MAX_COMMANDS];  // Size from statx, 0 when unknown
+    int reads = 0;
+    for (int i = 0; i < file_count; i++) {
+        fds[i] = results[2 * i];
+        if (fds[i] < 0) {
+            continue;
+        }
+
+        // Size the buffer from statx; /proc files and failed stats report no size
+        sizes[i] = 0;
+        if (results[2 * i + 1] == 0 && (stats[i].stx_mode & S_IFMT) == S_IFREG) {
+            sizes[i] = stats[i].stx_size;
+        }
+        lens[i] = URING_READ_SIZE;
+        if (sizes[i] > 0 && sizes[i] < lens[i]) {
+            lens[i] = sizes[i];
+        }
+        buffers[i] = malloc(lens[i]);
+        if (buffers[i] == NULL) {
+            results[2 * i] = -ENOMEM;  // Reported in phase 3 like a failed read
+            continue;
+        }
+
+        struct io_uring_sqe *sqe = uring_get_sqe(reads++);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fds[i];
+        sqe->addr = (unsigned long)buffers[i];
+        sqe->len = lens[i];
+        sqe->off = 0;
+        sqe->user_data = 2 * i;
+    }
+    // Every phase 1 entry has completed, so its memory is ours again
+    free(stats);
+    for (int i = 0; i < file_count; i++) {
+        free(paths[i]);
+    }
+
+    if (reads > 0) {
+        ret = uring_submit_and_wait(reads, results);
+        if (ret != 0) {
+            // Nothing has been printed yet, so the caller can start over with the syscalls
+            uring_shutdown();
+            for (int i = 0; i < file_count; i++) {
+                if (fds[i] < 0) continue;
+                close(fds[i]);
+                if (ret == -1) {
+                    free(buffers[i]);  // After -2 a read may still land in the buffer
+                }
+            }
+            return -1;
+        }
+    }
+
+    // Phase 3: write the results in command order
+    int failures = 0;
+    for (int i = 0; i < file_count; i++) {
+        if (fds[i] < 0) {
+            fprintf(stderr, "Error opening file '%s': %s\n", files[i], strerror(-fds[i]));
+            failures++;
+            continue;
+        }
+
+        int bytes = results[2 * i];
+        if (bytes < 0) {
+            fprintf(stderr, "Error reading file '%s': %s\n", files[i], strerror(-bytes));
+            failures++;
+        } else {
+            fwrite(buffers[i], 1, bytes, stdout);
+
+            // Unless statx gave the size and it has all been read, finish synchronously
+            if (sizes[i] == 0 || (size_t)bytes < sizes[i]) {
+                lseek(fds[i], bytes, SEEK_SET);  // IORING_OP_READ at offset 0 does not move the position
+                char buffer[4096];
+                ssize_t more;
+                while ((more = read(fds[i], buffer, sizeof(buffer))) > 0) {
+                    fwrite(buffer, 1, more, stdout);
+                }
+            }
+        }
+        printf("\n");
+
+        free(buffers[i]);
+        close(fds[i]);
+    }
+    return failures;
+}
+#endif
+
 // Main function to handle the background command
 void handle_background(char *input) {
     // Function to remove the trailing '+' from the input command
@@ -262,9 +695,10 @@ void handle_background(char *input) {
     } // Clean up the input
     char *args[MAX_ARGS + 1] = {0};  // Array to hold command arguments
     int arg_count = 0;              // Number of arguments
-    split_input_string(input, args, &arg_count);  // Split the input into arguments
-     if (arg_count > MAX_ARGS) {
-        printf("Error: More than %d arguments are not allowed.\n", MAX_ARGS);
+    // Split the input into arguments
+     if (split_input_string(input, args, &arg_count) != 0 || arg_count < 1) {
+        printf("Error: Number of arguments must be between 1 and %d.\n", MAX_ARGS);
+        last_status = 1;
         return;
     }
     execute_in_background(args);  // Execute the command in background
@@ -284,9 +718,12 @@ void execute_in_background(char *args[]) {
         // In parent process
         printf("Background process started with PID: %d\n", child_pid);
         bg_pid = child_pid;
+        last_bg_pid = child_pid;
+        last_status = 0;
     } else {
         // Fork failed, print an error message
         perror("fork");
+        last_status = 1;
     }
 }
 
@@ -296,6 +733,7 @@ void handle_foreground() {
     if (bg_pid == -1) {
         // No background process available
         printf("No background process available.\n");
+        last_status = 1;
         return;
     }
 
@@ -317,9 +755,11 @@ void handle_foreground() {
     if (WIFSTOPPED(status)) {
         // Process is stopped (e.g., due to a signal)
         printf("Process %d stopped\n", bg_pid);
+        last_status = exit_code(status);
     } else {
         // Process has finished executing
         printf("Process %d finished\n", bg_pid);
+        last_status = exit_code(status);
         bg_pid = -1;  // Reset the last background PID
     }
 
@@ -342,6 +782,7 @@ void handle_pipe(char *input) {
     // Check for too many commands
     if (num_cmds > MAX_COMMANDS) {
         print_error("Error: Too many commands in piped command. Maximum allowed is 4.");
+        last_status = 1;
         return;
     }
 
@@ -350,12 +791,13 @@ void handle_pipe(char *input) {
     for (int i = 0; i < num_cmds - 1; i++) {
         if (pipe(pipe_fds[i]) == -1) {
             perror("pipe");
+            last_status = 1;
             return;
         }
     }
 
   // Fork and execute commands
-    fork_and_execute_cmds(cmds, num_cmds, pipe_fds);
+    pid_t last_pid = fork_and_execute_cmds(cmds, num_cmds, pipe_fds);
 
     // Parent process: close all pipe file descriptors
     for (int i = 0; i < num_cmds - 1; i++) {
@@ -363,13 +805,17 @@ void handle_pipe(char *input) {
         close(pipe_fds[i][1]);
     }
 
-    // Wait for all child processes to finish
+    // Wait for all child processes to finish; the last command sets $?
     for (int i = 0; i < num_cmds; i++) {
-        wait(NULL);
+        int status;
+        if (wait(&status) == last_pid) {
+            last_status = exit_code(status);
+        }
     }
 }
 // Function to fork and execute commands
-void fork_and_execute_cmds(char *cmds[], int num_cmds, int pipe_fds[][2]) {
+pid_t fork_and_execute_cmds(char *cmds[], int num_cmds, int pipe_fds[][2]) {
+    pid_t pid = -1;
     for (int i = 0; i < num_cmds; i++) {
         char *args[MAX_ARGS + 1] = {0}; // Array to store arguments for execvp
         int arg_count = 0;             // Number of arguments
@@ -380,7 +826,7 @@ void fork_and_execute_cmds(char *cmds[], int num_cmds, int pipe_fds[][2]) {
             exit(1); // Exit if error occurs
         }
 
-        pid_t pid = fork(); // Fork a new process
+        pid = fork(); // Fork a new process
         if (pid == 0) {
             // Child process
             //Each process’s output is piped to the next process’s input
@@ -404,6 +850,7 @@ void fork_and_execute_cmds(char *cmds[], int num_cmds, int pipe_fds[][2]) {
             exit(1);
         }
     }
+    return pid; // PID of the last command in the pipeline
 }
 
 void handle_redirection(char *input) {
@@ -438,10 +885,13 @@ void handle_redirection(char *input) {
     // Trim leading/trailing whitespace from file names
     if (input_file) input_file = strtok(input_file, DELIMITERS);  
     if (output_file) output_file = strtok(output_file,DELIMITERS);  
+    if (input_file) input_file = expand_word(input_file);
+    if (output_file) output_file = expand_word(output_file);
 
     // Split command into arguments
     if (split_input_string(input, args, &argc) != 0) {
         print_error("Too many arguments in a command. Maximum allowed is 4.");  
+        last_status = 1;
         return;  
     }
 
@@ -496,7 +946,9 @@ void handle_redirection(char *input) {
     }
 
     // Parent process waits for child to finish
-    wait(NULL);  
+    int status;
+    waitpid(pid, &status, 0);
+    last_status = exit_code(status);
 }
 
 void handle_semicolon(char *input)
@@ -516,6 +968,7 @@ void handle_semicolon(char *input)
     if (num_commands > MAX_COMMANDS)
     {
         print_error("Too many commands. Maximum allowed is 4."); 
+        last_status = 1;
         return; 
     }
 
@@ -541,6 +994,7 @@ void handle_semicolon(char *input)
         if (strlen(trimmed_command) == 0)
         {
             print_error("Empty command."); 
+            last_status = 1;
             continue; 
         }
 
@@ -548,6 +1002,7 @@ void handle_semicolon(char *input)
         if (split_input_string(trimmed_command, args, &argc))
         {
             print_error("Too many arguments in a command. Maximum allowed is 4."); 
+            last_status = 1;
             continue; 
         }
 
@@ -555,6 +1010,7 @@ void handle_semicolon(char *input)
         if (argc < 1)
         {
             print_error("No command provided."); // Print error message
+            last_status = 1;
             continue; // Skip to the next command
         }
 
@@ -565,10 +1021,19 @@ void handle_semicolon(char *input)
 
 // Function to execute a single command
 int execute_single_command(char **cmd) {
+    char *args[MAX_ARGS + 1] = {0};
+
+    // Expand here rather than when tokenizing, so $? sees the previous command
+    for (int i = 0; i < MAX_ARGS && cmd[i] != NULL; i++) {
+        args[i] = expand_word(cmd[i]);
+    }
+    cmd = args;
+
     pid_t pid = fork();
      // If fork fails
     if (pid == -1) {
         perror("fork");
+        last_status = 1;
         return 0;
     } else if (pid == 0) {// In the child process
         execvp(cmd[0], cmd); // Execute the command
@@ -577,6 +1042,7 @@ int execute_single_command(char **cmd) {
     } else { // In the parent process
         int status;
         waitpid(pid, &status, 0); // Wait for the child process to finish
+        last_status = exit_code(status);
         // Return whether the command executed successfully
         return WIFEXITED(status) && WEXITSTATUS(status) == 0;
     }
@@ -598,6 +1064,7 @@ int handle_conditional_execution(char *input) {
             // Check for argument count and operator count limits
             if (arg_count == 0 || op_count >= MAX_COMMANDS - 1) {
                 fprintf(stderr, "Too many arguments in a command. Maximum allowed is 4.\n");
+                last_status = 1;
                 return 0;
             }
             // Store the operator and reset argument count
@@ -616,6 +1083,7 @@ int handle_conditional_execution(char *input) {
 
     if (cmd_count > MAX_COMMANDS) {
         fprintf(stderr, "Error: Too many commands (max %d)\n", MAX_COMMANDS - 1);
+        last_status = 1;
         return 0;
     }
 // Execute the first command and handle the logic for conditional execution
@@ -635,6 +1103,290 @@ int handle_conditional_execution(char *input) {
     return result;
 }
 
+// Structure to track one pmap invocation
+struct pmap_job {
+    pid_t pid;   // PID of the child running this batch
+    FILE *out;   // Buffered stdout of the child in ordered mode, NULL otherwise
+    int done;    // Set once the child has been reaped
+};
+
+// Function to build the argument list for one batch and start it in a child
+pid_t pmap_spawn(char *cmd[], int cmd_argc, char *items[], int item_count, FILE *out, int null_stdin) {
+    char *args[PMAP_MAX_ARGS + 1];
+    int argc = 0;
+    int replaced = 0;
+
+    // Every '{}' word is replaced by the items of the batch
+    for (int i = 0; i < cmd_argc; i++) {
+        if (strcmp(cmd[i], "{}") == 0) {
+            for (int j = 0; j < item_count; j++) {
+                args[argc++] = items[j];
+            }
+            replaced = 1;
+        } else {
+            args[argc++] = cmd[i];
+        }
+    }
+
+    // Without a '{}' the items are appended to the command, like xargs
+    if (!replaced) {
+        for (int j = 0; j < item_count; j++) {
+            args[argc++] = items[j];
+        }
+    }
+    args[argc] = NULL;
+
+    fflush(stdout);  // Do not let the child inherit unflushed shell output
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child process
+        // Items are being read from our stdin, so the child must not compete for it
+        if (null_stdin) {
+            int fd_null = open("/dev/null", O_RDONLY);
+            if (fd_null != -1) {
+                dup2(fd_null, 0);
+                close(fd_null);
+            }
+        }
+        // In ordered mode stdout goes to the job's temporary file
+        if (out != NULL) {
+            dup2(fileno(out), 1);
+            close(fileno(out));
+        }
+
+        execvp(args[0], args);
+        fprintf(stderr, "Failed to execute '%s': %s\n", args[0], strerror(errno));
+        exit(127);
+    } else if (pid < 0) {
+        perror("fork");
+    }
+    return pid;
+}
+
+// Function to run a command over input lines with up to N children in flight
+int handle_pmap(char *input) {
+    char *words[PMAP_MAX_ARGS] = {0};
+    int word_count = 0;
+    int max_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int batch = 1;
+    int ordered = 0;
+    char *list_file = NULL;
+
+    // Tokenize everything after "pmap"; the command is not bound by MAX_ARGS
+    strtok(input, DELIMITERS);
+    char *token = strtok(NULL, DELIMITERS);
+    while (token != NULL) {
+        if (word_count >= PMAP_MAX_ARGS) {
+            print_error("pmap: Too many arguments.");
+            return 1;
+        }
+        words[word_count++] = expand_word(token);
+        token = strtok(NULL, DELIMITERS);
+    }
+
+    // Parse the options in front of the command
+    int i = 0;
+    while (i < word_count && words[i][0] == '-') {
+        if (strcmp(words[i], "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(words[i], "-k") == 0) {
+            ordered = 1;
+            i++;
+        } else if (strcmp(words[i], "-j") == 0 && i + 1 < word_count) {
+            max_jobs = atoi(words[i + 1]);
+            i += 2;
+        } else if (strcmp(words[i], "-n") == 0 && i + 1 < word_count) {
+            batch = atoi(words[i + 1]);
+            i += 2;
+        } else if (strcmp(words[i], "-f") == 0 && i + 1 < word_count) {
+            list_file = words[i + 1];
+            i += 2;
+        } else {
+            print_error("Usage: pmap [-j jobs] [-n batch] [-k] [-f file] command [args] [{}]");
+            return 1;
+        }
+    }
+
+    char **cmd = words + i;
+    int cmd_argc = word_count - i;
+    if (cmd_argc < 1) {
+        print_error("pmap: No command provided.");
+        return 1;
+    }
+    if (max_jobs < 1 || batch < 1) {
+        print_error("pmap: Job and batch counts must be positive.");
+        return 1;
+    }
+    if (max_jobs > PMAP_MAX_JOBS) {
+        max_jobs = PMAP_MAX_JOBS;
+    }
+
+    // Make sure a full batch still fits in the argument list
+    int placeholders = 0;
+    for (int j = 0; j < cmd_argc; j++) {
+        if (strcmp(cmd[j], "{}") == 0) {
+            placeholders++;
+        }
+    }
+    int batch_words = placeholders > 0 ? placeholders * batch : batch;
+    if (cmd_argc - placeholders + batch_words > PMAP_MAX_ARGS) {
+        fprintf(stderr, "pmap: Batch too large. Maximum is %d words per command.\n", PMAP_MAX_ARGS);
+        return 1;
+    }
+
+    // Items come from the named file, or from stdin until EOF
+    FILE *src = stdin;
+    if (list_file != NULL) {
+        src = fopen(list_file, "r");
+        if (src == NULL) {
+            fprintf(stderr, "Error opening file '%s': %s\n", list_file, strerror(errno));
+            return 1;
+        }
+        fcntl(fileno(src), F_SETFD, FD_CLOEXEC);  // Children must not inherit the list
+    }
+
+    // Batches started but not yet printed live in a ring of window slots, indexed
+    // by batch number; capping it bounds the temp files held open in -k mode
+    int window = max_jobs * PMAP_PENDING_FACTOR;
+    struct pmap_job *jobs = calloc(window, sizeof(*jobs));
+    if (jobs == NULL) {
+        perror("calloc");
+        if (src != stdin) fclose(src);
+        return 1;
+    }
+
+    int job_count = 0;  // Batches started so far
+    int running = 0, next_print = 0, failed = 0, eof = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    char *items[PMAP_MAX_ARGS];
+    int item_count = 0;  // Items read but not yet handed to a child
+
+    while (!eof || item_count > 0 || running > 0) {
+        // Start new batches until max_jobs children are in flight
+        while (running < max_jobs && job_count - next_print < window) {
+            // Fill the batch; items held back from a previous pass are kept
+            while (!eof && item_count < batch) {
+                ssize_t len = getline(&line, &line_cap, src);
+                if (len == -1) {
+                    eof = 1;
+                    break;
+                }
+                line[strcspn(line, "\n")] = 0;
+                if (line[0] != '\0') {
+                    items[item_count++] = strdup(line);
+                }
+            }
+            if (item_count == 0) {
+                break;
+            }
+
+            FILE *out = NULL;
+            if (ordered && job_count > next_print) {
+                if ((out = tmpfile()) == NULL) {
+                    // Hold the items; once earlier output is printed this batch
+                    // becomes the oldest and needs no temp file
+                    break;
+                }
+                // Only the child that owns this file may keep it across exec
+                fcntl(fileno(out), F_SETFD, FD_CLOEXEC);
+            }
+            // In -k mode the oldest unprinted batch writes straight to stdout
+
+            pid_t pid = pmap_spawn(cmd, cmd_argc, items, item_count, out, src == stdin);
+            for (int j = 0; j < item_count; j++) {
+                free(items[j]);
+            }
+            item_count = 0;
+
+            struct pmap_job *job = &jobs[job_count % window];
+            job->pid = pid;
+            job->out = out;
+            job->done = pid < 0;
+            if (pid < 0) {
+                failed++;
+            } else {
+                running++;
+            }
+            job_count++;
+        }
+
+        // Wait for any child to finish so the next batch can take its slot
+        if (running > 0) {
+            int status;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("waitpid");
+                break;
+            }
+
+            int j = next_print;
+            while (j < job_count && (jobs[j % window].done || jobs[j % window].pid != pid)) {
+                j++;
+            }
+            if (j == job_count) {
+                // Not one of ours: the last background process has exited
+                if (pid == bg_pid) {
+                    printf("Process %d finished\n", bg_pid);
+                    bg_pid = -1;
+                }
+                continue;
+            }
+
+            jobs[j % window].done = 1;
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                failed++;
+            }
+        }
+
+        // Print finished output in input order, as far as it is complete
+        while (next_print < job_count && jobs[next_print % window].done) {
+            FILE *out = jobs[next_print % window].out;
+            if (out != NULL) {
+                char buffer[4096];
+                size_t bytes;
+                rewind(out);
+                while ((bytes = fread(buffer, 1, sizeof(buffer), out)) > 0) {
+                    fwrite(buffer, 1, bytes, stdout);
+                }
+                fclose(out);
+            }
+            next_print++;
+        }
+    }
+
+    // Clean up after an aborted wait
+    while (running > 0 && wait(NULL) > 0) {
+        running--;
+    }
+    for (int j = next_print; j < job_count; j++) {
+        if (jobs[j % window].out != NULL) {
+            fclose(jobs[j % window].out);
+        }
+    }
+    free(line);
+    fflush(stdout);
+    free(jobs);
+
+    if (src != stdin) {
+        fclose(src);
+    } else {
+        clearerr(stdin);  // Let the shell keep reading after the items' EOF
+    }
+
+    // Aggregate status follows xargs: 0 if every batch succeeded, 123 otherwise
+    if (failed > 0) {
+        fprintf(stderr, "pmap: %d of %d jobs failed\n", failed, job_count);
+        return 123;
+    }
+    return 0;
+}
+
 // Function to handle special characters in input
 void handle_special_chars(char *input)
 {
@@ -674,6 +1426,7 @@ void handle_special_chars(char *input)
          if (split_input_string(input, args, &argc) != 0)
         {
             print_error("Error: Invalid number of arguments. Must be between 1 and 4.");
+            last_status = 1;
             return;
         }
         else
@@ -683,11 +1436,341 @@ void handle_special_chars(char *input)
     }
 }
 
+// Function to turn a wait status into a shell exit status
+int exit_code(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    } else if (WIFSTOPPED(status)) {
+        return 128 + WSTOPSIG(status);
+    }
+    return 1;
+}
+
+// Function to hash a variable name (FNV-1a)
+unsigned long var_hash(const char *name, size_t len) {
+    unsigned long hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619UL;
+    }
+    return hash % VAR_BUCKETS;
+}
+
+// Function to find a variable by name, optionally creating an empty one
+struct shell_var *var_lookup(const char *name, size_t len, int create) {
+    unsigned long bucket = var_hash(name, len);
+    for (struct shell_var *var = var_table[bucket]; var != NULL; var = var->next) {
+        if (strncmp(var->name, name, len) == 0 && var->name[len] == '\0') {
+            return var;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    struct shell_var *var = calloc(1, sizeof(*var));
+    var->name = strndup(name, len);
+    var->value = NULL;  // Unset until var_set, so "export NAME" adds nothing to envp
+    var->next = var_table[bucket];
+    var_table[bucket] = var;
+    return var;
+}
+
+// Function to set a variable, keeping its exported flag
+void var_set(const char *name, const char *value) {
+    struct shell_var *var = var_lookup(name, strlen(name), 1);
+    free(var->value);
+    var->value = strdup(value);
+
+    // Only this variable's "NAME=VALUE" string is rebuilt; the others are reused
+    env_retire(var->env_entry);
+    var->env_entry = NULL;
+    if (var->exported) {
+        env_dirty = 1;
+    }
+}
+
+// Function to remove a variable from the table
+void var_unset(const char *name) {
+    struct shell_var **link = &var_table[var_hash(name, strlen(name))];
+    while (*link != NULL) {
+        struct shell_var *var = *link;
+        if (strcmp(var->name, name) == 0) {
+            *link = var->next;
+            if (var->exported) {
+                env_dirty = 1;
+            }
+            env_retire(var->env_entry);
+            free(var->name);
+            free(var->value);
+            free(var);
+            return;
+        }
+        link = &var->next;
+    }
+}
+
+// Function to import the inherited environment as exported variables
+void init_variables() {
+    for (char **env = environ; *env != NULL; env++) {
+        char *eq = strchr(*env, '=');
+        if (eq == NULL || !is_valid_name(*env, eq - *env)) {
+            continue;
+        }
+        struct shell_var *var = var_lookup(*env, eq - *env, 1);
+        free(var->value);
+        var->value = strdup(eq + 1);
+        var->exported = 1;
+    }
+    env_dirty = 1;
+}
+
+// Function to rebuild the envp array used by exec, only when it is stale
+void update_environ() {
+    if (!env_dirty) {
+        return;  // Reuse the cached array across launches
+    }
+
+    int count = 0;
+    for (int i = 0; i < VAR_BUCKETS; i++) {
+        for (struct shell_var *var = var_table[i]; var != NULL; var = var->next) {
+            if (var->exported && var->value != NULL) {
+                count++;
+            }
+        }
+    }
+
+    if (count + 1 > env_cache_cap) {
+        env_cache_cap = count + 1;
+        env_cache = realloc(env_cache, env_cache_cap * sizeof(char *));
+    }
+
+    int n = 0;
+    for (int i = 0; i < VAR_BUCKETS; i++) {
+        for (struct shell_var *var = var_table[i]; var != NULL; var = var->next) {
+            if (!var->exported || var->value == NULL) {
+                continue;
+            }
+            if (var->env_entry == NULL) {
+                size_t len = strlen(var->name) + strlen(var->value) + 2;
+                var->env_entry = malloc(len);
+                snprintf(var->env_entry, len, "%s=%s", var->name, var->value);
+            }
+            env_cache[n++] = var->env_entry;
+        }
+    }
+    env_cache[n] = NULL;
+
+    environ = env_cache;  // execvp passes environ to every child
+    env_dirty = 0;
+
+    // Nothing points at the replaced entries any more
+    for (int i = 0; i < env_stale_count; i++) {
+        free(env_stale[i]);
+    }
+    env_stale_count = 0;
+}
+
+// Function to free an old "NAME=VALUE" string once environ stops using it
+void env_retire(char *entry) {
+    if (entry == NULL) {
+        return;
+    }
+    if (env_stale_count == env_stale_cap) {
+        int new_cap = env_stale_cap ? env_stale_cap * 2 : 16;
+        char **new_stale = realloc(env_stale, new_cap * sizeof(char *));
+        if (new_stale == NULL) {
+            return;  // Leaking the entry is safer than freeing it under environ
+        }
+        env_stale = new_stale;
+        env_stale_cap = new_cap;
+    }
+    env_stale[env_stale_count++] = entry;
+    env_dirty = 1;
+}
+
+// Function to check that a name is [A-Za-z_][A-Za-z0-9_]*
+int is_valid_name(const char *name, size_t len) {
+    if (len == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_')) {
+        return 0;
+    }
+    for (size_t i = 1; i < len; i++) {
+        if (!(isalnum((unsigned char)name[i]) || name[i] == '_')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to check whether the input is a single NAME=VALUE word
+int is_assignment(const char *input) {
+    while (*input == ' ' || *input == '\t') input++;
+    const char *eq = strchr(input, '=');
+    if (eq == NULL || !is_valid_name(input, eq - input)) {
+        return 0;
+    }
+    // Anything after the value would be a command, which is not supported
+    const char *rest = eq + 1 + strcspn(eq + 1, DELIMITERS);
+    while (*rest == ' ' || *rest == '\t') rest++;
+    return *rest == '\0';
+}
+
+// Function to expand $VAR, ${VAR}, $? and $! into output, returning the length
+// Pass a NULL output to only measure the expanded length
+size_t expand_variables(const char *input, char *output) {
+    size_t out = 0;
+    char number[16];
+
+    for (const char *p = input; *p != '\0'; ) {
+        const char *value = NULL;
+
+        if (p[0] == '$' && p[1] == '?') {
+            snprintf(number, sizeof(number), "%d", last_status);
+            value = number;
+            p += 2;
+        } else if (p[0] == '$' && p[1] == '!') {
+            number[0] = '\0';
+            if (last_bg_pid != -1) {
+                snprintf(number, sizeof(number), "%d", last_bg_pid);
+            }
+            value = number;
+            p += 2;
+        } else if (p[0] == '$' && p[1] == '{' && strchr(p + 2, '}') != NULL) {
+            const char *end = strchr(p + 2, '}');
+            struct shell_var *var = var_lookup(p + 2, end - (p + 2), 0);
+            value = var && var->value ? var->value : "";
+            p = end + 1;
+        } else if (p[0] == '$' && (isalpha((unsigned char)p[1]) || p[1] == '_')) {
+            const char *end = p + 1;
+            while (isalnum((unsigned char)*end) || *end == '_') end++;
+            struct shell_var *var = var_lookup(p + 1, end - (p + 1), 0);
+            value = var && var->value ? var->value : "";
+            p = end;
+        } else {
+            // Not a variable reference, copy the character as is
+            if (output != NULL) {
+                output[out] = *p;
+            }
+            out++;
+            p++;
+            continue;
+        }
+
+        size_t len = strlen(value);
+        if (output != NULL) {
+            memcpy(output + out, value, len);
+        }
+        out += len;
+    }
+    if (output != NULL) {
+        output[out] = '\0';
+    }
+    return out;
+}
+
+// Function to expand one word after tokenizing, so values never act as operators
+char *expand_word(char *word) {
+    if (strchr(word, '$') == NULL) {
+        return word;  // Nothing to expand, keep pointing into the input line
+    }
+
+    if (expanded_count == expanded_cap) {
+        int new_cap = expanded_cap ? expanded_cap * 2 : 16;
+        char **new_words = realloc(expanded_words, new_cap * sizeof(char *));
+        if (new_words == NULL) {
+            perror("realloc");
+            return word;
+        }
+        expanded_words = new_words;
+        expanded_cap = new_cap;
+    }
+
+    char *expanded = malloc(expand_variables(word, NULL) + 1);
+    if (expanded == NULL) {
+        perror("malloc");
+        return word;
+    }
+    expand_variables(word, expanded);
+    expanded_words[expanded_count++] = expanded;  // Freed before the next command
+    return expanded;
+}
+
+// Function to free the words expanded for the previous command
+void free_expanded_words() {
+    for (int i = 0; i < expanded_count; i++) {
+        free(expanded_words[i]);
+    }
+    expanded_count = 0;
+}
+
+// Function to handle NAME=VALUE
+void handle_assignment(char *input) {
+    char *token = strtok(input, DELIMITERS);
+    char *eq = strchr(token, '=');
+    *eq = '\0';
+    var_set(token, expand_word(eq + 1));
+    last_status = 0;
+}
+
+// Function to handle the export builtin
+void handle_export(char *input) {
+    char *token = strtok(input + 6, DELIMITERS);
+    last_status = 0;
+
+    // With no arguments, list the exported variables
+    if (token == NULL) {
+        update_environ();
+        for (int i = 0; env_cache[i] != NULL; i++) {
+            printf("export %s\n", env_cache[i]);
+        }
+        return;
+    }
+
+    while (token != NULL) {
+        char *eq = strchr(token, '=');
+        size_t len = eq ? (size_t)(eq - token) : strlen(token);
+        if (!is_valid_name(token, len)) {
+            fprintf(stderr, "export: '%s': not a valid identifier\n", token);
+            last_status = 1;
+        } else {
+            if (eq != NULL) {
+                *eq = '\0';
+                var_set(token, expand_word(eq + 1));
+            }
+            struct shell_var *var = var_lookup(token, len, 1);
+            if (!var->exported) {
+                var->exported = 1;
+                env_dirty = 1;
+            }
+        }
+        token = strtok(NULL, DELIMITERS);
+    }
+}
+
+// Function to handle the unset builtin
+void handle_unset(char *input) {
+    char *token = strtok(input + 5, DELIMITERS);
+    last_status = 0;
+
+    while (token != NULL) {
+        token = expand_word(token);
+        if (!is_valid_name(token, strlen(token))) {
+            fprintf(stderr, "unset: '%s': not a valid identifier\n", token);
+            last_status = 1;
+        } else {
+            var_unset(token);
+        }
+        token = strtok(NULL, DELIMITERS);
+    }
+}
+
 // Function to split input string into arguments
 int split_input_string(char *input, char **args, int *argc) {
     char *token = strtok(input, DELIMITERS);
     while (token != NULL && *argc < MAX_ARGS) {
-        args[(*argc)++] = token; // Store each argument
+        args[(*argc)++] = expand_word(token); // Store each argument, with variables expanded
         token = strtok(NULL, DELIMITERS);
     }
     if (*argc >= MAX_ARGS && token != NULL) {